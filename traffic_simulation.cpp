@@ -14,6 +14,13 @@
 #include <algorithm>
 #include <mutex>
 #include <fstream>
+#include <array>
+#include <utility>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <cstdint>
+#include <cstdio>
 
 
 using namespace std;
@@ -36,7 +43,13 @@ const int MAX_RESOURCES = 10; // Example resource limit for Banker's Algorithm
 enum Direction { NORTH = 0, SOUTH, EAST, WEST };
 
 // Lanes
-enum Lane { LANE1 = 0, LANE2 }; // LANE1: Incoming, LANE2: Outgoing
+enum Lane { LANE1 = 0, LANE2, LANE3 }; // LANE1: Incoming, LANE2: Outgoing, LANE3: Arterial only
+
+// Turning movements
+enum Turn { THROUGH = 0, LEFT, RIGHT };
+
+// Progress of a vehicle through the intersection box
+enum BoxStage { APPROACHING, IN_BOX, DEPARTED };
 
 // Vehicle types
 enum VehicleType { REGULAR, HEAVY, EMERGENCY };
@@ -51,8 +64,403 @@ struct Vehicle {
     bool challanIssued;
     float speed; // Speed in pixels per frame
     bool breakdown;
+    Turn turn;
+    int movement;    // Index into the movement table
+    BoxStage stage;
+    bool turned;
+    float dx, dy;    // Current heading
+    float exitBound; // Vehicle exits once dot(position, heading) reaches this
+};
+
+// Intersection topology descriptors
+// A topology fixes the layout of an intersection at compile time: the number of approaches,
+// lanes per approach, the movement vector of each approach, the spawn point of each lane,
+// the exit bound and the traffic light placement. The vehicle kernels are instantiated per
+// approach, so the geometry is folded into the generated code instead of being branched on.
+// Traffic keeps to the right: every lane lies right of the road's centre line.
+const int MAX_TOPOLOGY_LANES = 3;
+
+struct SpawnPoint {
+    float x;
+    float y;
+};
+
+struct ApproachLayout {
+    Direction direction;          // Leg the approach enters from
+    float dx, dy;                 // Unit movement vector
+    float exitBound;              // Vehicle exits once dot(position, (dx, dy)) reaches this
+    float lightX, lightY;         // Position of the red lamp
+    float lightStepX, lightStepY; // Offset from one lamp to the next (red -> yellow -> green)
+    SpawnPoint spawn[MAX_TOPOLOGY_LANES]; // Lane 0 enters at the window edge
+    unsigned laneTurns[MAX_TOPOLOGY_LANES]; // Turns allowed from each lane (bit per Turn)
+};
+
+// Turns allowed from a lane
+const unsigned THROUGH_ONLY = 1u << THROUGH;
+const unsigned THROUGH_LEFT = (1u << THROUGH) | (1u << LEFT);
+const unsigned THROUGH_RIGHT = (1u << THROUGH) | (1u << RIGHT);
+const unsigned ANY_TURN = (1u << THROUGH) | (1u << LEFT) | (1u << RIGHT);
+
+// Distance along a heading at which a vehicle's front edge reaches the box
+constexpr float boxStopLine(float dx, float dy, float halfWidth) {
+    return (WINDOW_WIDTH / 2) * dx + (WINDOW_HEIGHT / 2) * dy - halfWidth - (dx + dy > 0 ? VEHICLE_SIZE : 0);
+}
+
+// Distance along a heading past which a vehicle's back edge has left the box
+constexpr float boxClearLine(float dx, float dy, float halfWidth) {
+    return (WINDOW_WIDTH / 2) * dx + (WINDOW_HEIGHT / 2) * dy + halfWidth + (dx + dy < 0 ? VEHICLE_SIZE : 0);
+}
+
+// Coordinate of a lane across its approach (x for vertical approaches, y for horizontal ones)
+constexpr float laneAcross(const ApproachLayout& a, int lane) {
+    return a.dx == 0 ? a.spawn[lane].x : a.spawn[lane].y;
+}
+
+// Exit bound for vehicles leaving the scene along an approach's leg, which is where that
+// leg's own traffic enters it
+constexpr float leavingBound(const ApproachLayout& a) {
+    return -(a.spawn[0].x * a.dx + a.spawn[0].y * a.dy);
+}
+
+// Distance of a lane's centre from the road's centre line
+constexpr float laneOffset(const ApproachLayout& a, int lane) {
+    float offset = laneAcross(a, lane) + VEHICLE_SIZE / 2.0f - (a.dx == 0 ? WINDOW_WIDTH / 2 : WINDOW_HEIGHT / 2);
+    return offset < 0 ? -offset : offset;
+}
+
+// Lanes spawned past the stop line carry traffic that has already crossed the box
+template <typename Topology>
+constexpr bool laneEntersBox(const ApproachLayout& a, int lane) {
+    return a.spawn[lane].x * a.dx + a.spawn[lane].y * a.dy <= boxStopLine(a.dx, a.dy, Topology::ROAD_HALF_WIDTH);
+}
+
+// Four-way crossing with one lane per direction on each road (the default layout)
+struct FourWayTopology {
+    static constexpr int APPROACHES = 4;
+    static constexpr int LANES = 2;
+    static constexpr int ROAD_HALF_WIDTH = LANE_WIDTH / 2;
+    static constexpr ApproachLayout approaches[APPROACHES] = {
+        {NORTH, 0, 1, WINDOW_HEIGHT, WINDOW_WIDTH / 2 - 40, 50, 40, 0,
+         {{WINDOW_WIDTH / 2 - LANE_WIDTH / 4 - VEHICLE_SIZE / 2, -VEHICLE_SIZE},
+          {WINDOW_WIDTH / 2 - LANE_WIDTH / 4 - VEHICLE_SIZE / 2, WINDOW_HEIGHT / 2 + LANE_WIDTH / 2}},
+         {ANY_TURN, THROUGH_ONLY}},
+        {SOUTH, 0, -1, VEHICLE_SIZE, WINDOW_WIDTH / 2 - 40, WINDOW_HEIGHT - 100, 40, 0,
+         {{WINDOW_WIDTH / 2 + LANE_WIDTH / 4 - VEHICLE_SIZE / 2, WINDOW_HEIGHT},
+          {WINDOW_WIDTH / 2 + LANE_WIDTH / 4 - VEHICLE_SIZE / 2, WINDOW_HEIGHT / 2 - LANE_WIDTH / 2 - VEHICLE_SIZE}},
+         {ANY_TURN, THROUGH_ONLY}},
+        {EAST, -1, 0, VEHICLE_SIZE, WINDOW_WIDTH - 100, WINDOW_HEIGHT / 2 - 40, 0, 40,
+         {{WINDOW_WIDTH, WINDOW_HEIGHT / 2 - LANE_WIDTH / 4 - VEHICLE_SIZE / 2},
+          {WINDOW_WIDTH / 2 - LANE_WIDTH / 2 - VEHICLE_SIZE, WINDOW_HEIGHT / 2 - LANE_WIDTH / 4 - VEHICLE_SIZE / 2}},
+         {ANY_TURN, THROUGH_ONLY}},
+        {WEST, 1, 0, WINDOW_WIDTH, 50, WINDOW_HEIGHT / 2 - 40, 0, 40,
+         {{-VEHICLE_SIZE, WINDOW_HEIGHT / 2 + LANE_WIDTH / 4 - VEHICLE_SIZE / 2},
+          {WINDOW_WIDTH / 2 + LANE_WIDTH / 2, WINDOW_HEIGHT / 2 + LANE_WIDTH / 4 - VEHICLE_SIZE / 2}},
+         {ANY_TURN, THROUGH_ONLY}}
+    };
+};
+
+// T-junction without a northern leg; traffic from the stem turns left or right
+struct TJunctionTopology {
+    static constexpr int APPROACHES = 3;
+    static constexpr int LANES = 2;
+    static constexpr int ROAD_HALF_WIDTH = LANE_WIDTH / 2;
+    static constexpr ApproachLayout approaches[APPROACHES] = {
+        {SOUTH, 0, -1, -(WINDOW_HEIGHT / 2 - LANE_WIDTH / 2), WINDOW_WIDTH / 2 - 40, WINDOW_HEIGHT - 100, 40, 0,
+         {{WINDOW_WIDTH / 2 + LANE_WIDTH / 8 - VEHICLE_SIZE / 2, WINDOW_HEIGHT},
+          {WINDOW_WIDTH / 2 + 3 * LANE_WIDTH / 8 - VEHICLE_SIZE / 2, WINDOW_HEIGHT}},
+         {THROUGH_LEFT, THROUGH_RIGHT}},
+        {EAST, -1, 0, VEHICLE_SIZE, WINDOW_WIDTH - 100, WINDOW_HEIGHT / 2 - 40, 0, 40,
+         {{WINDOW_WIDTH, WINDOW_HEIGHT / 2 - LANE_WIDTH / 8 - VEHICLE_SIZE / 2},
+          {WINDOW_WIDTH, WINDOW_HEIGHT / 2 - 3 * LANE_WIDTH / 8 - VEHICLE_SIZE / 2}},
+         {THROUGH_LEFT, THROUGH_RIGHT}},
+        {WEST, 1, 0, WINDOW_WIDTH, 50, WINDOW_HEIGHT / 2 - 40, 0, 40,
+         {{-VEHICLE_SIZE, WINDOW_HEIGHT / 2 + LANE_WIDTH / 8 - VEHICLE_SIZE / 2},
+          {-VEHICLE_SIZE, WINDOW_HEIGHT / 2 + 3 * LANE_WIDTH / 8 - VEHICLE_SIZE / 2}},
+         {THROUGH_LEFT, THROUGH_RIGHT}}
+    };
+};
+
+// Four-way crossing of two arterials with three lanes per direction
+struct ThreeLaneArterialTopology {
+    static constexpr int APPROACHES = 4;
+    static constexpr int LANES = 3;
+    static constexpr int ROAD_HALF_WIDTH = LANE_WIDTH;
+    static constexpr ApproachLayout approaches[APPROACHES] = {
+        {NORTH, 0, 1, WINDOW_HEIGHT, WINDOW_WIDTH / 2 - 40, 50, 40, 0,
+         {{WINDOW_WIDTH / 2 - LANE_WIDTH / 6 - VEHICLE_SIZE / 2, -VEHICLE_SIZE},
+          {WINDOW_WIDTH / 2 - LANE_WIDTH / 2 - VEHICLE_SIZE / 2, -VEHICLE_SIZE},
+          {WINDOW_WIDTH / 2 - 5 * LANE_WIDTH / 6 - VEHICLE_SIZE / 2, -VEHICLE_SIZE}},
+         {THROUGH_LEFT, THROUGH_ONLY, THROUGH_RIGHT}},
+        {SOUTH, 0, -1, VEHICLE_SIZE, WINDOW_WIDTH / 2 - 40, WINDOW_HEIGHT - 100, 40, 0,
+         {{WINDOW_WIDTH / 2 + LANE_WIDTH / 6 - VEHICLE_SIZE / 2, WINDOW_HEIGHT},
+          {WINDOW_WIDTH / 2 + LANE_WIDTH / 2 - VEHICLE_SIZE / 2, WINDOW_HEIGHT},
+          {WINDOW_WIDTH / 2 + 5 * LANE_WIDTH / 6 - VEHICLE_SIZE / 2, WINDOW_HEIGHT}},
+         {THROUGH_LEFT, THROUGH_ONLY, THROUGH_RIGHT}},
+        {EAST, -1, 0, VEHICLE_SIZE, WINDOW_WIDTH - 100, WINDOW_HEIGHT / 2 - 40, 0, 40,
+         {{WINDOW_WIDTH, WINDOW_HEIGHT / 2 - LANE_WIDTH / 6 - VEHICLE_SIZE / 2},
+          {WINDOW_WIDTH, WINDOW_HEIGHT / 2 - LANE_WIDTH / 2 - VEHICLE_SIZE / 2},
+          {WINDOW_WIDTH, WINDOW_HEIGHT / 2 - 5 * LANE_WIDTH / 6 - VEHICLE_SIZE / 2}},
+         {THROUGH_LEFT, THROUGH_ONLY, THROUGH_RIGHT}},
+        {WEST, 1, 0, WINDOW_WIDTH, 50, WINDOW_HEIGHT / 2 - 40, 0, 40,
+         {{-VEHICLE_SIZE, WINDOW_HEIGHT / 2 + LANE_WIDTH / 6 - VEHICLE_SIZE / 2},
+          {-VEHICLE_SIZE, WINDOW_HEIGHT / 2 + LANE_WIDTH / 2 - VEHICLE_SIZE / 2},
+          {-VEHICLE_SIZE, WINDOW_HEIGHT / 2 + 5 * LANE_WIDTH / 6 - VEHICLE_SIZE / 2}},
+         {THROUGH_LEFT, THROUGH_ONLY, THROUGH_RIGHT}}
+    };
 };
 
+// Compile-time sanity checks for a topology descriptor
+template <typename Topology>
+constexpr bool isValidTopology() {
+    if (Topology::APPROACHES < 1 || Topology::APPROACHES > 4) return false;
+    if (Topology::LANES < 1 || Topology::LANES > MAX_TOPOLOGY_LANES) return false;
+    for (int i = 0; i < Topology::APPROACHES; ++i) {
+        const ApproachLayout& a = Topology::approaches[i];
+        if (a.dx * a.dx + a.dy * a.dy != 1) return false; // Movement vectors must be unit length
+        if (a.direction == NORTH && a.dy != 1) return false; // Traffic moves away from its leg
+        if (a.direction == SOUTH && a.dy != -1) return false;
+        if (a.direction == EAST && a.dx != -1) return false;
+        if (a.direction == WEST && a.dx != 1) return false;
+        for (int lane = 0; lane < Topology::LANES; ++lane) {
+            // Spawn points must lie on the drawn road, on the right-hand side of the centre line
+            float across = laneAcross(a, lane) - (a.dx == 0 ? WINDOW_WIDTH / 2 : WINDOW_HEIGHT / 2);
+            if (across < -Topology::ROAD_HALF_WIDTH || across + VEHICLE_SIZE > Topology::ROAD_HALF_WIDTH) return false;
+            if ((across + VEHICLE_SIZE / 2.0f) * (a.dx - a.dy) < 0) return false;
+
+            // Lanes past the box no longer turn
+            if (!laneEntersBox<Topology>(a, lane) && a.laneTurns[lane] != THROUGH_ONLY) return false;
+        }
+        for (int lane = 0; lane < Topology::LANES; ++lane) {
+            for (int other = 0; other < Topology::LANES; ++other) {
+                // Left turns come from the innermost lane and right turns from the outermost,
+                // so movements from different lanes of one approach never cross
+                if (lane == other || !laneEntersBox<Topology>(a, lane) || !laneEntersBox<Topology>(a, other)) continue;
+                if ((a.laneTurns[lane] & (1u << LEFT)) && laneOffset(a, lane) >= laneOffset(a, other)) return false;
+                if ((a.laneTurns[lane] & (1u << RIGHT)) && laneOffset(a, lane) <= laneOffset(a, other)) return false;
+            }
+        }
+        for (int j = 0; j < Topology::APPROACHES; ++j) {
+            // Through traffic leaves where the opposing approach enters
+            const ApproachLayout& b = Topology::approaches[j];
+            if (b.dx == -a.dx && b.dy == -a.dy && a.exitBound != leavingBound(b)) return false;
+        }
+    }
+    return true;
+}
+
+static_assert(isValidTopology<FourWayTopology>(), "Invalid four-way topology");
+static_assert(isValidTopology<TJunctionTopology>(), "Invalid T-junction topology");
+static_assert(isValidTopology<ThreeLaneArterialTopology>(), "Invalid three-lane arterial topology");
+
+// Layout used by the simulation; switch layouts by naming another descriptor here
+using ActiveTopology = FourWayTopology;
+const int NUM_APPROACHES = ActiveTopology::APPROACHES;
+const int NUM_LANES = ActiveTopology::LANES;
+
+// Turning movements
+// Every approach carries through, left and right movements (right-hand traffic). A movement's
+// path through the box is the area a vehicle sweeps from the stop line to its turn and from the
+// turn until it has left the box; two movements conflict when their paths overlap. The conflicts
+// are precomputed as one bitmask per movement, so admitting a vehicle into the box is a single
+// AND against the bitmask of movements currently occupying it.
+const int NUM_TURNS = 3;
+
+// Legs are numbered clockwise on screen from the top: 0 = N, 1 = E, 2 = S, 3 = W
+constexpr int directionLeg[4] = {0, 2, 1, 3}; // Indexed by Direction
+
+constexpr int exitLeg(int leg, int turn) {
+    return (leg + (turn == THROUGH ? 2 : turn == LEFT ? 1 : 3)) % 4;
+}
+
+// Area swept by vehicles inside the box
+struct BoxRect {
+    float left, top, right, bottom;
+};
+
+// Area swept by a vehicle moving along an axis between two positions, over a range of lanes
+constexpr BoxRect sweptRect(bool vertical, float alongFrom, float alongTo, float acrossLo, float acrossHi) {
+    float alongLo = alongFrom < alongTo ? alongFrom : alongTo;
+    float alongHi = (alongFrom < alongTo ? alongTo : alongFrom) + VEHICLE_SIZE;
+    return vertical ? BoxRect{acrossLo, alongLo, acrossHi + VEHICLE_SIZE, alongHi}
+                    : BoxRect{alongLo, acrossLo, alongHi, acrossHi + VEHICLE_SIZE};
+}
+
+constexpr bool rectsOverlap(const BoxRect& a, const BoxRect& b) {
+    return a.left < b.right && b.left < a.right && a.top < b.bottom && b.top < a.bottom;
+}
+
+// Approach entering from a leg, or -1 if the topology has no such leg
+template <typename Topology>
+constexpr int approachOnLeg(int leg) {
+    for (int a = 0; a < Topology::APPROACHES; ++a) {
+        if (directionLeg[Topology::approaches[a].direction] == leg) return a;
+    }
+    return -1;
+}
+
+// Coordinate of the outgoing lane on an approach's leg, mirrored from its innermost or outermost entry lane
+template <typename Topology>
+constexpr float outgoingLane(const ApproachLayout& a, bool innermost) {
+    int chosen = -1;
+    for (int lane = 0; lane < Topology::LANES; ++lane) {
+        if (!laneEntersBox<Topology>(a, lane)) continue;
+        if (chosen < 0 || (innermost ? laneOffset(a, lane) < laneOffset(a, chosen)
+                                     : laneOffset(a, lane) > laneOffset(a, chosen))) {
+            chosen = lane;
+        }
+    }
+    float centre = a.dx == 0 ? WINDOW_WIDTH / 2 : WINDOW_HEIGHT / 2;
+    return 2 * centre - laneAcross(a, chosen) - VEHICLE_SIZE;
+}
+
+struct MovementLayout {
+    bool valid;            // Exit leg exists and a lane of the approach allows the turn
+    float exitDx, exitDy;  // Heading once the turn is made
+    float exitBound;       // Vehicle exits once dot(position, exit heading) reaches this
+    float turnPoint;       // Vehicle turns once dot(position, approach heading) reaches this
+    float clearLine;       // Vehicle has left the box once dot(position, exit heading) passes this
+    BoxRect path[2];       // Area swept before and after the turn
+    uint32_t conflicts;    // Movements that may not share the box with this one
+};
+
+// Movement id = approach * NUM_TURNS + turn
+template <typename Topology>
+struct MovementTable {
+    static constexpr int COUNT = Topology::APPROACHES * NUM_TURNS;
+    MovementLayout movements[COUNT];
+    float stopLine[Topology::APPROACHES];
+    uint32_t phases[Topology::APPROACHES];   // Distinct sets of approaches that are green together
+    int phaseCount;
+    int approachPhase[Topology::APPROACHES]; // Phase in which each approach is green
+};
+
+template <typename Topology>
+constexpr MovementTable<Topology> buildMovementTable() {
+    static_assert(MovementTable<Topology>::COUNT <= 32, "Movements must fit in a 32-bit mask");
+
+    MovementTable<Topology> table{};
+    const float halfWidth = Topology::ROAD_HALF_WIDTH;
+    for (int a = 0; a < Topology::APPROACHES; ++a) {
+        const ApproachLayout& approach = Topology::approaches[a];
+        bool vertical = approach.dx == 0;
+        float sign = approach.dx + approach.dy;
+        table.stopLine[a] = boxStopLine(approach.dx, approach.dy, halfWidth);
+
+        for (int turn = 0; turn < NUM_TURNS; ++turn) {
+            MovementLayout& movement = table.movements[a * NUM_TURNS + turn];
+
+            // Range of entry lanes the movement may use
+            bool hasLane = false;
+            float laneLo = 0, laneHi = 0;
+            for (int lane = 0; lane < Topology::LANES; ++lane) {
+                if (!laneEntersBox<Topology>(approach, lane) || !(approach.laneTurns[lane] & (1u << turn))) continue;
+                float across = laneAcross(approach, lane);
+                laneLo = hasLane && laneLo < across ? laneLo : across;
+                laneHi = hasLane && laneHi > across ? laneHi : across;
+                hasLane = true;
+            }
+
+            int leg = exitLeg(directionLeg[approach.direction], turn);
+            int exitApproach = approachOnLeg<Topology>(leg);
+            movement.valid = hasLane && exitApproach >= 0;
+            if (!movement.valid) continue;
+
+            // Vehicles leave against the exit leg's own traffic, where that traffic enters
+            const ApproachLayout& exit = Topology::approaches[exitApproach];
+            movement.exitDx = -exit.dx;
+            movement.exitDy = -exit.dy;
+            movement.exitBound = leavingBound(exit);
+
+            if (turn == THROUGH) {
+                movement.turnPoint = table.stopLine[a];
+                movement.clearLine = boxClearLine(approach.dx, approach.dy, halfWidth);
+                movement.path[0] = sweptRect(vertical, table.stopLine[a] * sign, movement.clearLine * sign, laneLo, laneHi);
+                movement.path[1] = movement.path[0];
+            } else {
+                movement.clearLine = boxClearLine(movement.exitDx, movement.exitDy, halfWidth);
+
+                // Left turns take the exit leg's innermost lane, right turns its outermost
+                float exitLane = outgoingLane<Topology>(exit, turn == LEFT);
+                float exitSign = movement.exitDx + movement.exitDy;
+                float clear = movement.clearLine * exitSign;
+                movement.turnPoint = exitLane * sign;
+                movement.path[0] = sweptRect(vertical, table.stopLine[a] * sign, exitLane, laneLo, laneHi);
+                movement.path[1] = sweptRect(!vertical, clear < laneLo ? clear : laneLo, clear > laneHi ? clear : laneHi,
+                                             exitLane, exitLane);
+            }
+        }
+    }
+
+    // Conflict matrix between valid movements of different approaches; movements of one
+    // approach use lanes on the side they turn to, so they never cross each other
+    for (int i = 0; i < MovementTable<Topology>::COUNT; ++i) {
+        for (int j = 0; j < MovementTable<Topology>::COUNT; ++j) {
+            const MovementLayout& a = table.movements[i];
+            const MovementLayout& b = table.movements[j];
+            if (!a.valid || !b.valid || i / NUM_TURNS == j / NUM_TURNS) continue;
+            if (rectsOverlap(a.path[0], b.path[0]) || rectsOverlap(a.path[0], b.path[1]) ||
+                rectsOverlap(a.path[1], b.path[0]) || rectsOverlap(a.path[1], b.path[1])) {
+                table.movements[i].conflicts |= 1u << j;
+            }
+        }
+    }
+
+    // Approaches whose through movements do not conflict share a green phase; turning
+    // vehicles within the phase are kept apart by the box admission check
+    for (int a = 0; a < Topology::APPROACHES; ++a) {
+        table.approachPhase[a] = -1;
+    }
+    for (int a = 0; a < Topology::APPROACHES; ++a) {
+        if (table.approachPhase[a] >= 0) continue;
+
+        int phase = table.phaseCount++;
+        table.phases[phase] = 1u << a;
+        table.approachPhase[a] = phase;
+        for (int b = a + 1; b < Topology::APPROACHES; ++b) {
+            if (table.approachPhase[b] >= 0) continue;
+
+            // A candidate joins only if it is compatible with every approach already in the phase
+            const MovementLayout& throughB = table.movements[b * NUM_TURNS + THROUGH];
+            bool compatible = throughB.valid;
+            for (int m = 0; m < Topology::APPROACHES && compatible; ++m) {
+                const MovementLayout& throughM = table.movements[m * NUM_TURNS + THROUGH];
+                if (!(table.phases[phase] & (1u << m))) continue;
+                compatible = throughM.valid && !(throughM.conflicts & (1u << (b * NUM_TURNS + THROUGH)));
+            }
+            if (compatible) {
+                table.phases[phase] |= 1u << b;
+                table.approachPhase[b] = phase;
+            }
+        }
+    }
+    return table;
+}
+
+template <typename Topology>
+constexpr MovementTable<Topology> movementTable = buildMovementTable<Topology>();
+
+// Every lane entering the box must allow at least one movement the topology supports
+template <typename Topology>
+constexpr bool everyLaneHasMovement() {
+    for (int a = 0; a < Topology::APPROACHES; ++a) {
+        const ApproachLayout& approach = Topology::approaches[a];
+        for (int lane = 0; lane < Topology::LANES; ++lane) {
+            bool found = !laneEntersBox<Topology>(approach, lane);
+            for (int turn = 0; turn < NUM_TURNS; ++turn) {
+                found = found || ((approach.laneTurns[lane] & (1u << turn)) && movementTable<Topology>.movements[a * NUM_TURNS + turn].valid);
+            }
+            if (!found) return false;
+        }
+    }
+    return true;
+}
+
+static_assert(everyLaneHasMovement<FourWayTopology>(), "Four-way topology has a lane without a movement");
+static_assert(everyLaneHasMovement<TJunctionTopology>(), "T-junction topology has a lane without a movement");
+static_assert(everyLaneHasMovement<ThreeLaneArterialTopology>(), "Three-lane arterial topology has a lane without a movement");
+
+const int NUM_MOVEMENTS = MovementTable<ActiveTopology>::COUNT;
+
 // Traffic light structure
 struct TrafficLight {
     sf::CircleShape red;
@@ -71,12 +479,165 @@ struct Challan {
     bool paid;
 };
 
+// Profiling
+// Build with -DENABLE_PROFILING to compile in scoped function timers, per-lock wait/hold
+// histograms and per-thread trace ring buffers. Profiling starts disabled and is toggled at
+// runtime with the P key; without the flag every hook below compiles away to nothing.
+#ifdef ENABLE_PROFILING
+const int TRACE_BUFFER_SIZE = 16384; // Events kept per thread; oldest are overwritten first
+const int LOCK_HISTOGRAM_BUCKETS = 24; // Bucket 0: <1us, bucket k: [2^(k-1), 2^k) us
+
+atomic<bool> profilingEnabled(false);
+const chrono::steady_clock::time_point profileEpoch = chrono::steady_clock::now();
+
+// Microseconds since program start
+inline uint64_t profileNow() {
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - profileEpoch).count();
+}
+
+// Trace event in Chrome "complete event" form
+struct TraceEvent {
+    const char* name;
+    const char* category;
+    uint64_t start;
+    uint64_t duration;
+};
+
+// Ring buffer owned by a single thread
+struct TraceBuffer {
+    int threadId;
+    uint64_t written;
+    TraceEvent events[TRACE_BUFFER_SIZE];
+};
+
+vector<unique_ptr<TraceBuffer>> traceBuffers;
+pthread_mutex_t traceRegistryLock = PTHREAD_MUTEX_INITIALIZER;
+
+// Function to get the calling thread's trace buffer, registering it on first use
+TraceBuffer& threadTraceBuffer() {
+    thread_local TraceBuffer* buffer = nullptr;
+    if (buffer == nullptr) {
+        pthread_mutex_lock(&traceRegistryLock);
+        traceBuffers.push_back(make_unique<TraceBuffer>());
+        buffer = traceBuffers.back().get();
+        buffer->threadId = traceBuffers.size();
+        buffer->written = 0;
+        pthread_mutex_unlock(&traceRegistryLock);
+    }
+    return *buffer;
+}
+
+void recordTraceEvent(const char* name, const char* category, uint64_t start, uint64_t duration) {
+    TraceBuffer& buffer = threadTraceBuffer();
+    buffer.events[buffer.written % TRACE_BUFFER_SIZE] = {name, category, start, duration};
+    buffer.written++;
+}
+
+// Scoped timer recording the lifetime of a function body
+struct ScopedTimer {
+    const char* name;
+    uint64_t start;
+    bool active;
+
+    explicit ScopedTimer(const char* timerName)
+        : name(timerName), start(0), active(profilingEnabled.load(memory_order_relaxed)) {
+        if (active) start = profileNow();
+    }
+    ~ScopedTimer() {
+        if (active) recordTraceEvent(name, "function", start, profileNow() - start);
+    }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ScopedTimer PROFILE_CONCAT(scopedTimer, __LINE__)(name)
+
+// Wait and hold statistics for a lock; only updated by the thread holding the lock
+struct LockStats {
+    uint64_t acquisitions;
+    uint64_t totalWait;
+    uint64_t totalHold;
+    uint64_t maxWait;
+    uint64_t maxHold;
+    uint64_t waitHistogram[LOCK_HISTOGRAM_BUCKETS];
+    uint64_t holdHistogram[LOCK_HISTOGRAM_BUCKETS];
+};
+
+// Mutex wrapper recording how long it is waited on and held
+struct ProfiledMutex {
+    pthread_mutex_t mutex;
+    char name[32];
+    uint64_t acquiredAt; // 0 when the current hold is not being profiled
+    LockStats stats;
+};
+
+int histogramBucket(uint64_t micros) {
+    int bucket = 0;
+    while (micros > 0 && bucket < LOCK_HISTOGRAM_BUCKETS - 1) {
+        micros >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void initMutex(ProfiledMutex& lock, const string& name) {
+    pthread_mutex_init(&lock.mutex, nullptr);
+    snprintf(lock.name, sizeof(lock.name), "%s", name.c_str());
+    lock.acquiredAt = 0;
+    lock.stats = LockStats();
+}
+
+void lockMutex(ProfiledMutex& lock) {
+    if (!profilingEnabled.load(memory_order_relaxed)) {
+        pthread_mutex_lock(&lock.mutex);
+        lock.acquiredAt = 0;
+        return;
+    }
+
+    uint64_t requested = profileNow();
+    pthread_mutex_lock(&lock.mutex);
+    uint64_t acquired = profileNow();
+    uint64_t wait = acquired - requested;
+
+    lock.stats.acquisitions++;
+    lock.stats.totalWait += wait;
+    lock.stats.maxWait = max(lock.stats.maxWait, wait);
+    lock.stats.waitHistogram[histogramBucket(wait)]++;
+    if (wait > 0) {
+        recordTraceEvent(lock.name, "lock_wait", requested, wait);
+    }
+    lock.acquiredAt = max<uint64_t>(acquired, 1);
+}
+
+void unlockMutex(ProfiledMutex& lock) {
+    if (lock.acquiredAt != 0) {
+        uint64_t hold = profileNow() - lock.acquiredAt;
+        lock.stats.totalHold += hold;
+        lock.stats.maxHold = max(lock.stats.maxHold, hold);
+        lock.stats.holdHistogram[histogramBucket(hold)]++;
+        recordTraceEvent(lock.name, "lock_hold", lock.acquiredAt, hold);
+        lock.acquiredAt = 0;
+    }
+    pthread_mutex_unlock(&lock.mutex);
+}
+#else
+#define PROFILE_SCOPE(name)
+
+struct ProfiledMutex {
+    pthread_mutex_t mutex;
+};
+
+inline void initMutex(ProfiledMutex& lock, const string&) { pthread_mutex_init(&lock.mutex, nullptr); }
+inline void lockMutex(ProfiledMutex& lock) { pthread_mutex_lock(&lock.mutex); }
+inline void unlockMutex(ProfiledMutex& lock) { pthread_mutex_unlock(&lock.mutex); }
+#endif
+
 // Shared variables
-queue<Vehicle> trafficQueues[4][2];         // Separate queues for each direction and lane
-pthread_mutex_t queueLocks[4][2];          // Mutex for each direction and lane
-TrafficLight trafficLights[4];
-Direction currentGreenDirection = NORTH;
-pthread_mutex_t trafficLightLock;
+queue<Vehicle> trafficQueues[NUM_APPROACHES][NUM_LANES]; // Separate queues for each direction and lane
+ProfiledMutex queueLocks[NUM_APPROACHES][NUM_LANES];    // Mutex for each direction and lane
+TrafficLight trafficLights[NUM_APPROACHES];
+int currentPhase = 0; // Index into the active topology's green phases
+ProfiledMutex trafficLightLock;
 
 // Analytics
 map<string, int> analytics = {
@@ -95,7 +656,12 @@ int availableResources = MAX_RESOURCES;
 map<string, int> allocatedResources;
 map<string, int> maximumResources;
 
-pthread_mutex_t resourceLock;
+ProfiledMutex resourceLock;
+
+// Intersection box occupancy
+uint32_t occupiedMovements = 0;           // Bit per movement currently inside the box
+int movementOccupancy[NUM_MOVEMENTS] = {}; // Vehicles of each movement inside the box
+ProfiledMutex boxLock;
 
 // Mock time
 time_t mockTime = time(nullptr);
@@ -114,7 +680,9 @@ string formatTime(time_t rawTime) {
 
 // Function to initialize traffic lights
 void initializeTrafficLights() {
-    for (int i = 0; i < 4; ++i) {
+    for (int i = 0; i < NUM_APPROACHES; ++i) {
+        const ApproachLayout& layout = ActiveTopology::approaches[i];
+
         trafficLights[i].red.setRadius(TRAFFIC_LIGHT_RADIUS);
         trafficLights[i].yellow.setRadius(TRAFFIC_LIGHT_RADIUS);
         trafficLights[i].green.setRadius(TRAFFIC_LIGHT_RADIUS);
@@ -123,29 +691,13 @@ void initializeTrafficLights() {
         trafficLights[i].yellow.setFillColor(sf::Color::Black);
         trafficLights[i].green.setFillColor(sf::Color::Black);
 
+        // Position traffic lights from the topology layout
+        trafficLights[i].red.setPosition(layout.lightX, layout.lightY);
+        trafficLights[i].yellow.setPosition(layout.lightX + layout.lightStepX, layout.lightY + layout.lightStepY);
+        trafficLights[i].green.setPosition(layout.lightX + 2 * layout.lightStepX, layout.lightY + 2 * layout.lightStepY);
+
         trafficLights[i].emergencyPriority = false;
     }
-
-    // Position traffic lights
-    // NORTH
-    trafficLights[NORTH].red.setPosition(WINDOW_WIDTH / 2 - 40, 50);
-    trafficLights[NORTH].yellow.setPosition(WINDOW_WIDTH / 2, 50);
-    trafficLights[NORTH].green.setPosition(WINDOW_WIDTH / 2 + 40, 50);
-
-    // SOUTH
-    trafficLights[SOUTH].red.setPosition(WINDOW_WIDTH / 2 - 40, WINDOW_HEIGHT - 100);
-    trafficLights[SOUTH].yellow.setPosition(WINDOW_WIDTH / 2, WINDOW_HEIGHT - 100);
-    trafficLights[SOUTH].green.setPosition(WINDOW_WIDTH / 2 + 40, WINDOW_HEIGHT - 100);
-
-    // WEST
-    trafficLights[WEST].red.setPosition(50, WINDOW_HEIGHT / 2 - 40);
-    trafficLights[WEST].yellow.setPosition(50, WINDOW_HEIGHT / 2);
-    trafficLights[WEST].green.setPosition(50, WINDOW_HEIGHT / 2 + 40);
-
-    // EAST
-    trafficLights[EAST].red.setPosition(WINDOW_WIDTH - 100, WINDOW_HEIGHT / 2 - 40);
-    trafficLights[EAST].yellow.setPosition(WINDOW_WIDTH - 100, WINDOW_HEIGHT / 2);
-    trafficLights[EAST].green.setPosition(WINDOW_WIDTH - 100, WINDOW_HEIGHT / 2 + 40);
 }
 
 // Function to issue challans for speeding
@@ -238,6 +790,7 @@ void handleBreakdown(Vehicle& vehicle) {
 
 // Banker's Algorithm for deadlock prevention
 bool isSafeState() {
+    PROFILE_SCOPE("isSafeState");
     int work = availableResources;
     map<string, bool> finish;
     for (auto& [vehicle, allocated] : allocatedResources) {
@@ -263,10 +816,10 @@ bool isSafeState() {
 }
 
 bool requestResources(string vehicleId, int request) {
-    pthread_mutex_lock(&resourceLock);
+    lockMutex(resourceLock);
 
     if (request > availableResources) {
-        pthread_mutex_unlock(&resourceLock);
+        unlockMutex(resourceLock);
         return false; // Request cannot be granted immediately
     }
 
@@ -276,39 +829,68 @@ bool requestResources(string vehicleId, int request) {
     if (!isSafeState()) {
         availableResources += request;
         allocatedResources[vehicleId] -= request;
-        pthread_mutex_unlock(&resourceLock);
+        unlockMutex(resourceLock);
         return false;
     }
 
-    pthread_mutex_unlock(&resourceLock);
+    unlockMutex(resourceLock);
     return true;
 }
 
 void releaseResources(string vehicleId, int release) {
-    pthread_mutex_lock(&resourceLock);
+    lockMutex(resourceLock);
 
     allocatedResources[vehicleId] -= release;
     availableResources += release;
 
-    pthread_mutex_unlock(&resourceLock);
+    unlockMutex(resourceLock);
+}
+
+// Function to admit a vehicle's movement into the intersection box
+bool enterBox(int movement) {
+    lockMutex(boxLock);
+    bool admitted = (movementTable<ActiveTopology>.movements[movement].conflicts & occupiedMovements) == 0;
+    if (admitted) {
+        occupiedMovements |= 1u << movement;
+        movementOccupancy[movement]++;
+    }
+    unlockMutex(boxLock);
+    return admitted;
+}
+
+// Function to release a vehicle's movement once it has left the box
+void leaveBox(int movement) {
+    lockMutex(boxLock);
+    if (--movementOccupancy[movement] == 0) {
+        occupiedMovements &= ~(1u << movement);
+    }
+    unlockMutex(boxLock);
 }
 
 // Function to manage queues and enforce lane capacity
-void manageQueues(Direction direction) {
-    for (int lane = 0; lane < 2; ++lane) {
-        pthread_mutex_lock(&queueLocks[direction][lane]);
-        while (trafficQueues[direction][lane].size() > MAX_LANE_CAPACITY) {
-            trafficQueues[direction][lane].pop();
+void manageQueues(int approach) {
+    Direction direction = ActiveTopology::approaches[approach].direction;
+    for (int lane = 0; lane < NUM_LANES; ++lane) {
+        lockMutex(queueLocks[approach][lane]);
+        while (trafficQueues[approach][lane].size() > MAX_LANE_CAPACITY) {
+            if (trafficQueues[approach][lane].front().stage == IN_BOX) {
+                leaveBox(trafficQueues[approach][lane].front().movement);
+            }
+            trafficQueues[approach][lane].pop();
             cout << "Queue overflow! Vehicle removed from " << direction << " lane " << lane << endl;
             analytics["totalVehicles"]--; // Adjust total vehicles count
         }
-        pthread_mutex_unlock(&queueLocks[direction][lane]);
+        unlockMutex(queueLocks[approach][lane]);
     }
 }
 
-// Function to simulate vehicle arrival
-void generateVehicle(Direction direction, Lane lane) {
-    pthread_mutex_lock(&queueLocks[direction][lane]);
+// Function to simulate vehicle arrival, instantiated per topology approach
+template <int Approach>
+void generateVehicle(Lane lane) {
+    PROFILE_SCOPE("generateVehicle");
+    constexpr ApproachLayout layout = ActiveTopology::approaches[Approach];
+
+    lockMutex(queueLocks[Approach][lane]);
     Vehicle vehicle;
     // Randomly assign vehicle type
     int randType = rand() % 100;
@@ -332,7 +914,7 @@ void generateVehicle(Direction direction, Lane lane) {
         vehicle.speed = SPEED_LIMIT + 5 + (rand() % 5); // 15-19
     }
 
-    vehicle.direction = direction;
+    vehicle.direction = layout.direction;
     vehicle.lane = lane;
     vehicle.vehicleNumber = "VEH" + to_string(rand() % 1000);
     vehicle.challanIssued = false;
@@ -346,34 +928,31 @@ void generateVehicle(Direction direction, Lane lane) {
         vehicle.shape.setFillColor(sf::Color::Blue);
     }
 
-    // Set initial position based on direction and lane
-    if (direction == NORTH) {
-        if (lane == LANE1) { // Incoming
-            vehicle.shape.setPosition(WINDOW_WIDTH / 2 + lane * LANE_WIDTH / 2, -VEHICLE_SIZE);
-        } else { // Outgoing
-            vehicle.shape.setPosition(WINDOW_WIDTH / 2 + lane * LANE_WIDTH / 2, WINDOW_HEIGHT / 2 + LANE_WIDTH / 2);
-        }
-    } else if (direction == SOUTH) {
-        if (lane == LANE1) { // Incoming
-            vehicle.shape.setPosition(WINDOW_WIDTH / 2 - lane * LANE_WIDTH / 2, WINDOW_HEIGHT);
-        } else { // Outgoing
-            vehicle.shape.setPosition(WINDOW_WIDTH / 2 - lane * LANE_WIDTH / 2, WINDOW_HEIGHT / 2 - LANE_WIDTH / 2);
+    // Set initial position from the lane's spawn point
+    vehicle.shape.setPosition(layout.spawn[lane].x, layout.spawn[lane].y);
+    vehicle.dx = layout.dx;
+    vehicle.dy = layout.dy;
+    vehicle.exitBound = layout.exitBound;
+    vehicle.turned = false;
+
+    // Vehicles spawned past the stop line have already crossed the box
+    bool pastBox = layout.spawn[lane].x * layout.dx + layout.spawn[lane].y * layout.dy > movementTable<ActiveTopology>.stopLine[Approach];
+    vehicle.stage = pastBox ? DEPARTED : APPROACHING;
+
+    // Pick a turning movement (60% through), falling back to one the lane and topology allow
+    int turn = THROUGH;
+    if (!pastBox) {
+        if (rand() % 100 >= 60) {
+            turn = rand() % 2 ? LEFT : RIGHT;
         }
-    } else if (direction == EAST) {
-        if (lane == LANE1) { // Incoming
-            vehicle.shape.setPosition(WINDOW_WIDTH, WINDOW_HEIGHT / 2 + lane * LANE_WIDTH / 2);
-        } else { // Outgoing
-            vehicle.shape.setPosition(WINDOW_WIDTH / 2 - LANE_WIDTH / 2, WINDOW_HEIGHT / 2 + lane * LANE_WIDTH / 2);
-        }
-    } else if (direction == WEST) {
-        if (lane == LANE1) { // Incoming
-            vehicle.shape.setPosition(-VEHICLE_SIZE, WINDOW_HEIGHT / 2 - lane * LANE_WIDTH / 2);
-        } else { // Outgoing
-            vehicle.shape.setPosition(WINDOW_WIDTH / 2 + LANE_WIDTH / 2, WINDOW_HEIGHT / 2 - lane * LANE_WIDTH / 2);
+        while (!(layout.laneTurns[lane] & (1u << turn)) || !movementTable<ActiveTopology>.movements[Approach * NUM_TURNS + turn].valid) {
+            turn = (turn + 1) % NUM_TURNS;
         }
     }
+    vehicle.turn = static_cast<Turn>(turn);
+    vehicle.movement = Approach * NUM_TURNS + turn;
 
-    trafficQueues[direction][lane].push(vehicle);
+    trafficQueues[Approach][lane].push(vehicle);
     analytics["totalVehicles"]++;
     if (vehicle.type == EMERGENCY) {
         analytics["emergencyVehicles"]++;
@@ -382,37 +961,44 @@ void generateVehicle(Direction direction, Lane lane) {
         handleBreakdown(vehicle);
     }
 
-    pthread_mutex_unlock(&queueLocks[direction][lane]);
+    unlockMutex(queueLocks[Approach][lane]);
 }
 
 // Function to handle traffic light control
 void* trafficLightController(void* arg) {
     while (window.isOpen()) {
-        pthread_mutex_lock(&trafficLightLock);
+        lockMutex(trafficLightLock);
 
         // Check for emergency vehicles and prioritize their direction
         bool emergencyFound = false;
-        for (int dir = 0; dir < 4 && !emergencyFound; ++dir) {
-            for (int lane = 0; lane < 2 && !emergencyFound; ++lane) {
-                pthread_mutex_lock(&queueLocks[dir][lane]);
+        for (int dir = 0; dir < NUM_APPROACHES && !emergencyFound; ++dir) {
+            for (int lane = 0; lane < NUM_LANES && !emergencyFound; ++lane) {
+                lockMutex(queueLocks[dir][lane]);
                 if (!trafficQueues[dir][lane].empty() && trafficQueues[dir][lane].front().type == EMERGENCY) {
-                    currentGreenDirection = static_cast<Direction>(dir);
+                    currentPhase = movementTable<ActiveTopology>.approachPhase[dir];
                     trafficLights[dir].emergencyPriority = true;
                     emergencyFound = true;
                 }
-                pthread_mutex_unlock(&queueLocks[dir][lane]);
+                unlockMutex(queueLocks[dir][lane]);
             }
         }
 
         if (!emergencyFound) {
-            trafficLights[currentGreenDirection].emergencyPriority = false;
-            // Round-robin traffic light switching
-            currentGreenDirection = static_cast<Direction>((currentGreenDirection + 1) % 4);
+            for (int i = 0; i < NUM_APPROACHES; ++i) {
+                if (movementTable<ActiveTopology>.phases[currentPhase] & (1u << i)) {
+                    trafficLights[i].emergencyPriority = false;
+                }
+            }
+            // Round-robin through the distinct green phases
+            currentPhase = (currentPhase + 1) % movementTable<ActiveTopology>.phaseCount;
         }
 
+        // Approaches with compatible through movements share the green phase
+        uint32_t greenApproaches = movementTable<ActiveTopology>.phases[currentPhase];
+
         // Update traffic light states
-        for (int i = 0; i < 4; ++i) {
-            if (i == currentGreenDirection) {
+        for (int i = 0; i < NUM_APPROACHES; ++i) {
+            if (greenApproaches & (1u << i)) {
                 trafficLights[i].red.setFillColor(sf::Color::Black);
                 trafficLights[i].green.setFillColor(sf::Color::Green);
                 trafficLights[i].yellow.setFillColor(sf::Color::Black);
@@ -423,36 +1009,47 @@ void* trafficLightController(void* arg) {
             }
         }
 
-        pthread_mutex_unlock(&trafficLightLock);
+        unlockMutex(trafficLightLock);
 
         // Simulate green light duration
         sleep(GREEN_LIGHT_DURATION);
 
         // Transition to yellow light
-        pthread_mutex_lock(&trafficLightLock);
-        if (trafficLights[currentGreenDirection].green.getFillColor() == sf::Color::Green) {
-            trafficLights[currentGreenDirection].green.setFillColor(sf::Color::Black);
-            trafficLights[currentGreenDirection].yellow.setFillColor(sf::Color::Yellow);
+        lockMutex(trafficLightLock);
+        for (int i = 0; i < NUM_APPROACHES; ++i) {
+            if ((greenApproaches & (1u << i)) && trafficLights[i].green.getFillColor() == sf::Color::Green) {
+                trafficLights[i].green.setFillColor(sf::Color::Black);
+                trafficLights[i].yellow.setFillColor(sf::Color::Yellow);
+            }
         }
-        pthread_mutex_unlock(&trafficLightLock);
+        unlockMutex(trafficLightLock);
 
         // Simulate yellow light duration
         sleep(YELLOW_LIGHT_DURATION);
 
         // Transition to red light
-        pthread_mutex_lock(&trafficLightLock);
-        trafficLights[currentGreenDirection].yellow.setFillColor(sf::Color::Black);
-        trafficLights[currentGreenDirection].red.setFillColor(sf::Color::Red);
-        pthread_mutex_unlock(&trafficLightLock);
+        lockMutex(trafficLightLock);
+        for (int i = 0; i < NUM_APPROACHES; ++i) {
+            if (greenApproaches & (1u << i)) {
+                trafficLights[i].yellow.setFillColor(sf::Color::Black);
+                trafficLights[i].red.setFillColor(sf::Color::Red);
+            }
+        }
+        unlockMutex(trafficLightLock);
     }
     return nullptr;
 }
 
-// Function to move vehicles based on traffic light state
-void moveVehicles(Direction direction) {
-    for (int lane = 0; lane < 2; ++lane) {
-        pthread_mutex_lock(&queueLocks[direction][lane]);
-        queue<Vehicle>& vehicleQueue = trafficQueues[direction][lane];
+// Function to move vehicles based on traffic light state, instantiated per topology approach
+template <int Approach>
+void moveVehicles() {
+    PROFILE_SCOPE("moveVehicles");
+    constexpr ApproachLayout layout = ActiveTopology::approaches[Approach];
+    constexpr float stopLine = movementTable<ActiveTopology>.stopLine[Approach];
+
+    for (int lane = 0; lane < NUM_LANES; ++lane) {
+        lockMutex(queueLocks[Approach][lane]);
+        queue<Vehicle>& vehicleQueue = trafficQueues[Approach][lane];
         size_t size = vehicleQueue.size();
 
         for (size_t i = 0; i < size; ++i) {
@@ -461,39 +1058,27 @@ void moveVehicles(Direction direction) {
 
             // Check if the traffic light is green for this direction
             bool isGreen = false;
-            pthread_mutex_lock(&trafficLightLock);
-            if (trafficLights[direction].green.getFillColor() == sf::Color::Green) {
+            lockMutex(trafficLightLock);
+            if (trafficLights[Approach].green.getFillColor() == sf::Color::Green) {
                 isGreen = true;
             }
-            pthread_mutex_unlock(&trafficLightLock);
-
-            if (isGreen) {
-                // Move vehicle forward based on direction and lane
-                if (direction == NORTH) {
-                    if (lane == LANE1) { // Incoming
-                        vehicle.shape.move(0, vehicle.speed);
-                    } else { // Outgoing
-                        vehicle.shape.move(0, vehicle.speed);
-                    }
-                } else if (direction == SOUTH) {
-                    if (lane == LANE1) { // Incoming
-                        vehicle.shape.move(0, -vehicle.speed);
-                    } else { // Outgoing
-                        vehicle.shape.move(0, -vehicle.speed);
-                    }
-                } else if (direction == EAST) {
-                    if (lane == LANE1) { // Incoming
-                        vehicle.shape.move(-vehicle.speed, 0);
-                    } else { // Outgoing
-                        vehicle.shape.move(-vehicle.speed, 0);
-                    }
-                } else if (direction == WEST) {
-                    if (lane == LANE1) { // Incoming
-                        vehicle.shape.move(vehicle.speed, 0);
-                    } else { // Outgoing
-                        vehicle.shape.move(vehicle.speed, 0);
-                    }
+            unlockMutex(trafficLightLock);
+
+            // Approaching vehicles move on green, but wait at the stop line until their movement
+            // is admitted into the box; vehicles inside or past the box always keep clearing it
+            bool canMove = vehicle.stage != APPROACHING;
+            if (vehicle.stage == APPROACHING && isGreen) {
+                sf::Vector2f position = vehicle.shape.getPosition();
+                bool atStopLine = position.x * layout.dx + position.y * layout.dy + vehicle.speed > stopLine;
+                canMove = !atStopLine || enterBox(vehicle.movement);
+                if (atStopLine && canMove) {
+                    vehicle.stage = IN_BOX;
                 }
+            }
+
+            if (canMove) {
+                // Move vehicle forward along its current heading
+                vehicle.shape.move(vehicle.dx * vehicle.speed, vehicle.dy * vehicle.speed);
 
                 // Update vehicle's speed and enforce speed limit
                 if (vehicle.speed > SPEED_LIMIT && vehicle.type != EMERGENCY) {
@@ -507,101 +1092,131 @@ void moveVehicles(Direction direction) {
                 
             }
 
-            // Re-add the vehicle if it's still within bounds
+            // Turn onto the exit heading, then release the movement once the box is cleared
             sf::Vector2f position = vehicle.shape.getPosition();
-            bool inBounds = false;
-            if (direction == NORTH && position.y < WINDOW_HEIGHT / 2 + LANE_WIDTH) {
-                inBounds = true;
-            } else if (direction == SOUTH && position.y > WINDOW_HEIGHT / 2 - LANE_WIDTH) {
-                inBounds = true;
-            } else if (direction == EAST && position.x > WINDOW_WIDTH / 2 - LANE_WIDTH) {
-                inBounds = true;
-            } else if (direction == WEST && position.x < WINDOW_WIDTH / 2 + LANE_WIDTH) {
-                inBounds = true;
+            if (vehicle.stage == IN_BOX) {
+                const MovementLayout& movement = movementTable<ActiveTopology>.movements[vehicle.movement];
+                float travelled = position.x * layout.dx + position.y * layout.dy;
+                if (!vehicle.turned && travelled >= movement.turnPoint) {
+                    if (vehicle.turn != THROUGH) {
+                        // Line up with the exit lane before heading off along it
+                        vehicle.shape.move(layout.dx * (movement.turnPoint - travelled), layout.dy * (movement.turnPoint - travelled));
+                        position = vehicle.shape.getPosition();
+                    }
+                    vehicle.dx = movement.exitDx;
+                    vehicle.dy = movement.exitDy;
+                    vehicle.exitBound = movement.exitBound;
+                    vehicle.turned = true;
+                }
+                if (vehicle.turned && position.x * vehicle.dx + position.y * vehicle.dy > movement.clearLine) {
+                    leaveBox(vehicle.movement);
+                    vehicle.stage = DEPARTED;
+                }
             }
 
+            // Re-add the vehicle if it's still within bounds
+            bool inBounds = position.x * vehicle.dx + position.y * vehicle.dy < vehicle.exitBound;
+
             if (inBounds) {
                 vehicleQueue.push(vehicle);
             } else {
+                if (vehicle.stage == IN_BOX) {
+                    leaveBox(vehicle.movement);
+                }
                 cout << "Vehicle exited! Vehicle Number: " << vehicle.vehicleNumber << endl;
-                releaseResources(vehicle.vehicleNumber, 1); // Release resources upon exit
             }
         }
-        pthread_mutex_unlock(&queueLocks[direction][lane]);
+        unlockMutex(queueLocks[Approach][lane]);
     }
 }
 
+// Move vehicles on every approach of the active topology
+template <size_t... Approaches>
+void moveAllVehicles(index_sequence<Approaches...>) {
+    (moveVehicles<Approaches>(), ...);
+}
+
 // Function to draw lanes
 void drawLanes() {
-    // Draw horizontal lanes (East-West)
-    sf::RectangleShape horizontalLane1(sf::Vector2f(WINDOW_WIDTH, LANE_WIDTH / 2));
-    horizontalLane1.setFillColor(sf::Color(200, 200, 200));
-    horizontalLane1.setPosition(0, (WINDOW_HEIGHT / 2) - LANE_WIDTH / 2);
-    window.draw(horizontalLane1);
-
-    sf::RectangleShape horizontalLane2(sf::Vector2f(WINDOW_WIDTH, LANE_WIDTH / 2));
-    horizontalLane2.setFillColor(sf::Color(200, 200, 200));
-    horizontalLane2.setPosition(0, (WINDOW_HEIGHT / 2));
-    window.draw(horizontalLane2);
-
-    // Draw vertical lanes (North-South)
-    sf::RectangleShape verticalLane1(sf::Vector2f(LANE_WIDTH / 2, WINDOW_HEIGHT));
-    verticalLane1.setFillColor(sf::Color(200, 200, 200));
-    verticalLane1.setPosition((WINDOW_WIDTH / 2) - LANE_WIDTH / 2, 0);
-    window.draw(verticalLane1);
-
-    sf::RectangleShape verticalLane2(sf::Vector2f(LANE_WIDTH / 2, WINDOW_HEIGHT));
-    verticalLane2.setFillColor(sf::Color(200, 200, 200));
-    verticalLane2.setPosition((WINDOW_WIDTH / 2), 0);
-    window.draw(verticalLane2);
+    const float halfWidth = ActiveTopology::ROAD_HALF_WIDTH;
+
+    // Draw the intersection box
+    sf::RectangleShape box(sf::Vector2f(2 * halfWidth, 2 * halfWidth));
+    box.setFillColor(sf::Color(200, 200, 200));
+    box.setPosition(WINDOW_WIDTH / 2 - halfWidth, WINDOW_HEIGHT / 2 - halfWidth);
+    window.draw(box);
+
+    // Draw one road leg per approach, from the window edge to the box
+    for (int i = 0; i < NUM_APPROACHES; ++i) {
+        const ApproachLayout& layout = ActiveTopology::approaches[i];
+        bool vertical = layout.dx == 0;
+
+        sf::RectangleShape leg(vertical ? sf::Vector2f(2 * halfWidth, WINDOW_HEIGHT / 2)
+                                        : sf::Vector2f(WINDOW_WIDTH / 2, 2 * halfWidth));
+        leg.setFillColor(sf::Color(200, 200, 200));
+        if (vertical) {
+            leg.setPosition(WINDOW_WIDTH / 2 - halfWidth, layout.dy > 0 ? 0 : WINDOW_HEIGHT / 2);
+        } else {
+            leg.setPosition(layout.dx > 0 ? 0 : WINDOW_WIDTH / 2, WINDOW_HEIGHT / 2 - halfWidth);
+        }
+        window.draw(leg);
+    }
 }
 
 // Function to draw the entire scene
 void drawScene() {
+    PROFILE_SCOPE("drawScene");
     window.clear(sf::Color::White);
 
     // Draw lanes
     drawLanes();
 
     // Draw traffic lights
-    for (int i = 0; i < 4; ++i) {
+    for (int i = 0; i < NUM_APPROACHES; ++i) {
         window.draw(trafficLights[i].red);
         window.draw(trafficLights[i].yellow);
         window.draw(trafficLights[i].green);
     }
 
     // Draw vehicles
-    for (int dir = 0; dir < 4; dir++) {
-        for (int lane = 0; lane < 2; lane++) {
-            pthread_mutex_lock(&queueLocks[dir][lane]);
+    for (int dir = 0; dir < NUM_APPROACHES; dir++) {
+        for (int lane = 0; lane < NUM_LANES; lane++) {
+            lockMutex(queueLocks[dir][lane]);
             queue<Vehicle> tempQueue = trafficQueues[dir][lane];
             while (!tempQueue.empty()) {
                 Vehicle vehicle = tempQueue.front();
                 tempQueue.pop();
                 window.draw(vehicle.shape);
             }
-            pthread_mutex_unlock(&queueLocks[dir][lane]);
+            unlockMutex(queueLocks[dir][lane]);
         }
     }
 
     window.display();
 }
 
-// Function to simulate vehicle arrival at intervals
-void* vehicleGenerator(void* arg) {
-    Direction direction = *(Direction*)arg;
-    srand(time(NULL) + direction); // Seed based on direction to diversify
+// Function to simulate vehicle arrival at intervals, one thread per topology approach
+template <int Approach>
+void* vehicleGenerator(void*) {
+    srand(time(NULL) + Approach); // Seed based on direction to diversify
 
     while (window.isOpen()) {
         sleep(rand() % 3 + 1); // Random interval between vehicle arrivals (1-3 seconds)
 
-        // Generate vehicles for both lanes
-        generateVehicle(direction, LANE1); // Incoming
-        generateVehicle(direction, LANE2); // Outgoing
-        manageQueues(direction);
+        // Generate vehicles for every lane of the approach
+        for (int lane = 0; lane < NUM_LANES; ++lane) {
+            generateVehicle<Approach>(static_cast<Lane>(lane));
+        }
+        manageQueues(Approach);
     }
     return nullptr;
 }
+
+// Thread entry points for every approach of the active topology
+template <size_t... Approaches>
+constexpr array<void* (*)(void*), sizeof...(Approaches)> makeVehicleGenerators(index_sequence<Approaches...>) {
+    return {{&vehicleGenerator<Approaches>...}};
+}
 void saveAnalyticsToFile(const string& filename) {
     ofstream file(filename);
     if (file.is_open()) {
@@ -617,18 +1232,84 @@ void saveAnalyticsToFile(const string& filename) {
     }
 }
 
+#ifdef ENABLE_PROFILING
+// Function to flush every thread's trace buffer as Chrome/Perfetto trace JSON
+void saveTraceToFile(const string& filename) {
+    ofstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error: Unable to open file " << filename << endl;
+        return;
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    pthread_mutex_lock(&traceRegistryLock);
+    for (const auto& buffer : traceBuffers) {
+        uint64_t count = min<uint64_t>(buffer->written, TRACE_BUFFER_SIZE);
+        for (uint64_t i = buffer->written - count; i < buffer->written; ++i) {
+            const TraceEvent& event = buffer->events[i % TRACE_BUFFER_SIZE];
+            file << (first ? "" : ",") << "\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+                 << "\",\"ph\":\"X\",\"ts\":" << event.start << ",\"dur\":" << event.duration
+                 << ",\"pid\":1,\"tid\":" << buffer->threadId << "}";
+            first = false;
+        }
+    }
+    pthread_mutex_unlock(&traceRegistryLock);
+    file << "\n]}\n";
+    file.close();
+    cout << "Trace saved to " << filename << endl;
+}
+
+void writeLockStats(ofstream& file, const ProfiledMutex& lock) {
+    const LockStats& stats = lock.stats;
+    if (stats.acquisitions == 0) return;
+
+    file << lock.name << ": acquisitions " << stats.acquisitions
+         << ", avg wait " << stats.totalWait / stats.acquisitions << "us, max wait " << stats.maxWait << "us"
+         << ", avg hold " << stats.totalHold / stats.acquisitions << "us, max hold " << stats.maxHold << "us\n";
+    for (int bucket = 0; bucket < LOCK_HISTOGRAM_BUCKETS; ++bucket) {
+        if (stats.waitHistogram[bucket] == 0 && stats.holdHistogram[bucket] == 0) continue;
+        file << "  < " << (1ULL << bucket) << "us: wait " << stats.waitHistogram[bucket]
+             << ", hold " << stats.holdHistogram[bucket] << "\n";
+    }
+}
+
+// Function to save lock wait/hold histograms
+void saveLockProfileToFile(const string& filename) {
+    ofstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error: Unable to open file " << filename << endl;
+        return;
+    }
+
+    file << "Lock Contention Profile\n";
+    file << "-----------------------\n";
+    for (int dir = 0; dir < NUM_APPROACHES; ++dir) {
+        for (int lane = 0; lane < NUM_LANES; ++lane) {
+            writeLockStats(file, queueLocks[dir][lane]);
+        }
+    }
+    writeLockStats(file, trafficLightLock);
+    writeLockStats(file, resourceLock);
+    writeLockStats(file, boxLock);
+    file.close();
+    cout << "Lock profile saved to " << filename << endl;
+}
+#endif
+
 // Entry point
 int main() {
       srand(time(NULL)); // Seed the random number generator
 
     // Initialize mutexes
-    for (int dir = 0; dir < 4; ++dir) {
-        for (int lane = 0; lane < 2; ++lane) {
-            pthread_mutex_init(&queueLocks[dir][lane], nullptr);
+    for (int dir = 0; dir < NUM_APPROACHES; ++dir) {
+        for (int lane = 0; lane < NUM_LANES; ++lane) {
+            initMutex(queueLocks[dir][lane], "queueLock[" + to_string(dir) + "][" + to_string(lane) + "]");
         }
     }
-    pthread_mutex_init(&trafficLightLock, nullptr);
-    pthread_mutex_init(&resourceLock, nullptr);
+    initMutex(trafficLightLock, "trafficLightLock");
+    initMutex(resourceLock, "resourceLock");
+    initMutex(boxLock, "boxLock");
     pthread_mutex_init(&timeLock, nullptr);
 
     // Initialize traffic lights
@@ -639,10 +1320,10 @@ int main() {
     pthread_create(&trafficLightThread, nullptr, trafficLightController, nullptr);
 
     // Launch vehicle generator threads for each direction
-    pthread_t vehicleThreads[4];
-    Direction directions[4] = {NORTH, SOUTH, EAST, WEST};
-    for (int i = 0; i < 4; ++i) {
-        pthread_create(&vehicleThreads[i], nullptr, vehicleGenerator, &directions[i]);
+    pthread_t vehicleThreads[NUM_APPROACHES];
+    constexpr auto vehicleGenerators = makeVehicleGenerators(make_index_sequence<NUM_APPROACHES>{});
+    for (int i = 0; i < NUM_APPROACHES; ++i) {
+        pthread_create(&vehicleThreads[i], nullptr, vehicleGenerators[i], nullptr);
     }
  bool simulationRunning = true;
 
@@ -668,13 +1349,16 @@ int main() {
                                 simulationRunning = !simulationRunning;
                                 cout << "Simulation " << (simulationRunning ? "resumed" : "paused") << endl;
                             }
+#ifdef ENABLE_PROFILING
+                            if (event.key.code == sf::Keyboard::P) {
+                                profilingEnabled = !profilingEnabled;
+                                cout << "Profiling " << (profilingEnabled ? "enabled" : "disabled") << endl;
+                            }
+#endif
                         }
                     }
                     if (simulationRunning) {
-                        moveVehicles(NORTH);
-                        moveVehicles(SOUTH);
-                        moveVehicles(EAST);
-                        moveVehicles(WEST);
+                        moveAllVehicles(make_index_sequence<NUM_APPROACHES>{});
                          // Draw the updated scene
                         drawScene();
 
@@ -694,19 +1378,25 @@ int main() {
                 pthread_cancel(trafficLightThread);
     pthread_join(trafficLightThread, nullptr);
 
-    for (int i = 0; i < 4; ++i) {
+    for (int i = 0; i < NUM_APPROACHES; ++i) {
         pthread_cancel(vehicleThreads[i]);
         pthread_join(vehicleThreads[i], nullptr);
     }
 
+#ifdef ENABLE_PROFILING
+    saveTraceToFile("trace.json");
+    saveLockProfileToFile("lock_profile.txt");
+#endif
+
     // Destroy mutexes
-    for (int dir = 0; dir < 4; ++dir) {
-        for (int lane = 0; lane < 2; ++lane) {
-            pthread_mutex_destroy(&queueLocks[dir][lane]);
+    for (int dir = 0; dir < NUM_APPROACHES; ++dir) {
+        for (int lane = 0; lane < NUM_LANES; ++lane) {
+            pthread_mutex_destroy(&queueLocks[dir][lane].mutex);
         }
     }
-    pthread_mutex_destroy(&trafficLightLock);
-    pthread_mutex_destroy(&resourceLock);
+    pthread_mutex_destroy(&trafficLightLock.mutex);
+    pthread_mutex_destroy(&resourceLock.mutex);
+    pthread_mutex_destroy(&boxLock.mutex);
     pthread_mutex_destroy(&timeLock);
 
                 return 0;